@@ -1,10 +1,219 @@
 ﻿#include "mainwindow.h"
+#include "weatheralert.h"
+#include "weatherprofiler.h"
+#include "weatherregion.h"
+#include "weathertool.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
+#define SOAK_INTERVAL_MS 1000  // 压力测试的刷新间隔
+#define SOAK_STARTUP_TIMEOUT_MS 30000  // 压力测试等待第一次请求完成的时间
+#define BENCH_CITIES 3000      // 预警基准测试的城市数
+#define BENCH_DAYS 15          // 预警基准测试每个城市的预报天数
+#define BENCH_ROUNDS 200       // 预警基准测试的轮数
+#define BENCH_LIMIT_MS 1.0     // 全部城市重算一次的目标耗时
+
+// 命令行导出各省汇总（不显示界面）：
+// weather --export-regions <输出文件> <城市名> [城市名...]
+static int exportRegions(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    int index = args.indexOf("--export-regions");
+    QString filePath = args.value(index + 1);
+    QStringList cities = args.mid(index + 2);
+    if (filePath.isEmpty() || cities.isEmpty()) {
+        qWarning() << "usage: --export-regions <file> <city> [city...]";
+        return 1;
+    }
+
+    RegionAggregator aggregator;
+    QNetworkAccessManager manager;
+    int pending = 0;
+    int failures = 0;  // 任何一个城市失败都返回非 0，避免导出不完整的数据却显示成功
+
+    for (int i = 0; i < cities.size(); i++) {
+        QString cityCode = WeatherTool::getCityCode(cities[i]);
+        if (cityCode.isEmpty()) {
+            qWarning() << "unknown city:" << cities[i];
+            failures++;
+            continue;
+        }
+
+        pending++;
+        QNetworkReply *reply = manager.get(QNetworkRequest(WeatherTool::getWeatherUrl(cityCode)));
+        QObject::connect(reply, &QNetworkReply::finished, &a, [&, reply, cityCode]() {
+            Today today;
+            Day days[6];
+            if (reply->error() == QNetworkReply::NoError && WeatherTool::parseWeather(reply->readAll(), today, days)) {
+                // 与界面一致，从今天开始的 5 天
+                aggregator.updateCity(cityCode, days + 1, 5);
+            } else {
+                qWarning() << "request failed:" << cityCode << reply->errorString();
+                failures++;
+            }
+            reply->deleteLater();
+
+            if (--pending == 0) {
+                a.quit();
+            }
+        });
+    }
+
+    if (pending > 0) {
+        a.exec();
+    }
+
+    if (!aggregator.exportJson(filePath)) {
+        qWarning() << "cannot write:" << filePath;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// 预警计算的基准测试（不显示界面）：
+// weather --bench-alerts
+// 填充 BENCH_CITIES 个城市 × BENCH_DAYS 天的数据，每轮修改所有城市后计时 evaluate()，
+// 输出最短和中位耗时，中位耗时不低于 BENCH_LIMIT_MS 时返回 1（应使用发布版测试）
+static int benchAlerts() {
+    WeatherAlertEngine engine;
+    engine.addRule(AlertRule(AlertRule::AqiAbove, 150, 3, TypeNone, "aqi"));
+    engine.addRule(AlertRule(AlertRule::HighAbove, 35, 3, TypeNone, "high"));
+    engine.addRule(AlertRule(AlertRule::LowDrop, 8, ALERT_DAYS, TypeNone, "low drop"));
+    engine.addRule(AlertRule(AlertRule::TypeMatch, 0, ALERT_DAYS, TypeRainstorm | TypeBlizzard, "storm"));
+
+    // 固定种子的线性同余序列，每次运行的数据相同
+    unsigned int seed = 12345;
+    auto next = [&seed](int range) {
+        seed = seed * 1103515245u + 12345u;
+        return int((seed >> 16) % unsigned(range));
+    };
+
+    QStringList codes;
+    for (int c = 0; c < BENCH_CITIES; c++) {
+        codes << QString::number(101000000 + c);
+    }
+
+    int high[BENCH_DAYS], low[BENCH_DAYS], aqi[BENCH_DAYS];
+    uint8_t types[BENCH_DAYS];
+    std::vector<double> times;
+    int events = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        // 每轮所有城市的数据都变化，evaluate() 要重算全部城市
+        for (int c = 0; c < BENCH_CITIES; c++) {
+            for (int d = 0; d < BENCH_DAYS; d++) {
+                high[d] = 10 + next(30);
+                low[d] = high[d] - 5 - next(10);
+                aqi[d] = next(300);
+                types[d] = next(20) == 0 ? uint8_t(TypeRainstorm) : uint8_t(TypeNone);
+            }
+            engine.updateCity(codes[c], high, low, aqi, types, BENCH_DAYS);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        events += engine.evaluate().size();
+        times.push_back(timer.nsecsElapsed() / 1e6);
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    qInfo().noquote() << QString("bench-alerts: %1 cities x %2 days, %3 rounds, min %4 ms, median %5 ms, %6 events")
+                             .arg(BENCH_CITIES)
+                             .arg(BENCH_DAYS)
+                             .arg(BENCH_ROUNDS)
+                             .arg(times.front(), 0, 'f', 3)
+                             .arg(median, 0, 'f', 3)
+                             .arg(events);
+    return median < BENCH_LIMIT_MS ? 0 : 1;
+}
+
+// 内存分析模式：
+// weather --memprofile [--mem-budget <预算>] [--api <接口地址>] [--soak <周期数>]
+// 启动阶段到第一次请求解析成功并绘制完曲线（MainWindow::ready）为止，之后才开始计周期
+// --soak 每隔 SOAK_INTERVAL_MS 刷新一次当前城市，跑完指定周期后检查预算，
+// 超出预算、有请求或解析失败、一次都没有成功、或者启动超时时返回 1
 int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--export-regions") == 0) {
+            return exportRegions(argc, argv);
+        }
+        if (strcmp(argv[i], "--bench-alerts") == 0) {
+            return benchAlerts();
+        }
+        if (strcmp(argv[i], "--memprofile") == 0) {
+            // 尽早打开，统计到启动阶段的分配
+            MemoryProfiler::setEnabled(true);
+        }
+    }
+
+    MemoryProfiler::setStage(StageStartup);
     QApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    int soakCycles = 0;
+    for (int i = 1; i < args.size() - 1; i++) {
+        if (args[i] == "--api") {
+            WeatherTool::setApiUrl(args[i + 1]);
+        } else if (args[i] == "--soak") {
+            soakCycles = args[i + 1].toInt();
+        } else if (args[i] == "--mem-budget" && !MemoryProfiler::setBudgets(args[i + 1])) {
+            qWarning() << "invalid --mem-budget:" << args[i + 1];
+            return 1;
+        }
+    }
+
     MainWindow w;
+    if (soakCycles > 0) {
+        // 不弹窗、不预取，请求数只取决于刷新周期
+        w.setQuiet(true);
+    }
     w.show();
-    return a.exec();
+
+    QTimer *timer = new QTimer(&a);
+    int cycle = 0;
+    // 排队调用，不在绘制事件的 ProfileScope 中切换阶段
+    QObject::connect(&w, &MainWindow::ready, &a, [&]() {
+        MemoryProfiler::setStage(StageOther);
+        MemoryProfiler::endCycle();  // 启动阶段结束
+        if (soakCycles > 0) {
+            timer->start(SOAK_INTERVAL_MS);
+        }
+    }, Qt::QueuedConnection);
+
+    if (soakCycles > 0) {
+        QTimer::singleShot(SOAK_STARTUP_TIMEOUT_MS, &a, [&]() {
+            if (!timer->isActive()) {
+                qWarning() << "soak: startup did not finish, requests succeeded" << w.successCount()
+                           << "failed" << w.failureCount();
+                a.exit(1);
+            }
+        });
+
+        QObject::connect(timer, &QTimer::timeout, &a, [&]() {
+            MemoryProfiler::endCycle();
+            if (++cycle > soakCycles) {
+                timer->stop();
+                bool pass = MemoryProfiler::checkBudgets();
+                if (w.failureCount() > 0 || w.successCount() == 0) {
+                    qWarning() << "soak: requests succeeded" << w.successCount() << "failed" << w.failureCount();
+                    pass = false;
+                }
+                a.exit(pass ? 0 : 1);
+                return;
+            }
+            w.refresh();
+        });
+    }
+
+    int ret = a.exec();
+    if (MemoryProfiler::isEnabled()) {
+        qDebug().noquote() << MemoryProfiler::report();
+    }
+    return ret;
 }
@@ -1,9 +1,7 @@
 ﻿#include "mainwindow.h"
 
 #include "ui_mainwindow.h"
-// weathertool.h 有初始化静态成员变量，故只能放在此处，头文件中不可以放变量的定义或初始化静态成员变量
-// 如果把定义放到头文件的话，就不能避免多次定义变量，C++ 不允许多次定义变量
-// https://blog.csdn.net/u012422524/article/details/127645265
+// weathertool.h 的静态成员使用 C++17 inline 变量，可以被多个源文件包含
 #include "weathertool.h"
 
 #define INCREMENT 1.2     // 温度每升高/降低 1°，y 坐标的增量
@@ -11,7 +9,9 @@
 #define TEXT_OFFSET_X 12
 #define TEXT_OFFSET_Y 12
 
-MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
+MainWindow::MainWindow(QWidget* parent)
+    : QMainWindow(parent), ui(new Ui::MainWindow), mQuiet(false), mReady(false), mPaintPending(0),
+      mSuccessCount(0), mFailureCount(0) {
     ui->setupUi(this);
 
     //设置窗口属性
@@ -20,7 +20,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
 
     // 右键菜单：退出程序
     mExitMenu = new QMenu(this);
-    mExitAct = new QAction();
+    mExitAct = new QAction(this);
     mExitAct->setText(tr("Exit"));
     mExitAct->setIcon(QIcon(":/res/close.png"));
     mExitMenu->addAction(mExitAct);
@@ -29,15 +29,36 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
         qApp->exit(0);
     });
 
+    // 右键菜单：导出各省汇总
+    mExportAct = new QAction(this);
+    mExportAct->setText(tr("Export regions"));
+    mExitMenu->insertAction(mExitAct, mExportAct);
+
+    connect(mExportAct, &QAction::triggered, this, [=]() {
+        QString filePath = QFileDialog::getSaveFileName(this, u8"导出地区汇总", "regions.json", "JSON (*.json)");
+        if (!filePath.isEmpty() && !mRegion.exportJson(filePath)) {
+            QMessageBox::warning(this, u8"提示", u8"导出失败！", QMessageBox::Ok);
+        }
+    });
+
     // 天气类型
     weatherType();
 
+    // 预警规则
+    mAlertEngine.addRule(AlertRule(AlertRule::AqiAbove, 150, 3, TypeNone, u8"3 天内空气质量中度污染"));
+    mAlertEngine.addRule(AlertRule(AlertRule::HighAbove, 35, 3, TypeNone, u8"3 天内最高温 35°C 以上"));
+    mAlertEngine.addRule(AlertRule(AlertRule::LowDrop, 8, ALERT_DAYS, TypeNone, u8"最低温骤降 8°C 以上"));
+    mAlertEngine.addRule(AlertRule(AlertRule::TypeMatch, 0, ALERT_DAYS, TypeRainstorm | TypeBlizzard, u8"暴雨/暴雪"));
+
     mNetAccessManager = new QNetworkAccessManager(this);
     connect(mNetAccessManager, &QNetworkAccessManager::finished, this, &MainWindow::onReplied);
 
+    mPrefetcher = new WeatherPrefetcher(this);
+    connect(mPrefetcher, &WeatherPrefetcher::prefetched, this, &MainWindow::onPrefetched);
+
     // 直接在构造中请求天气数据
     //getWeatherInfo("101010100");  // 101010100 表示北京城市编码
-    getWeatherInfo(u8"北京");
+    getWeatherInfo(u8"北京", false);  // 默认城市不算用户搜索，避免每次启动都增加北京的查看次数
 
     // 给标签添加事件过滤器
     // 事件过滤器是接收发送到该对象的所有事件的对象，过滤器可以停止事件或将其转发到此对象（this）
@@ -68,7 +89,8 @@ void MainWindow::mouseMoveEvent(QMouseEvent* event) {
 }
 
 // 发送一个 GET 请求
-void MainWindow::getWeatherInfo(QString cityName) {
+void MainWindow::getWeatherInfo(QString cityName, bool userInitiated) {
+    ProfileScope scope(StageLookup);
     QString cityCode = WeatherTool::getCityCode(cityName);
 
     if (cityCode.isEmpty()) {
@@ -76,102 +98,71 @@ void MainWindow::getWeatherInfo(QString cityName) {
         return;
     }
 
-    QUrl url("http://t.weather.itboy.net/api/weather/city/" + cityCode);
-    mNetAccessManager->get(QNetworkRequest(url));
-}
-
-// 解析天气数据并更新 UI
-void MainWindow::parseJson(QByteArray &byteArray) {
-    QJsonParseError err;
-    QJsonDocument doc = QJsonDocument::fromJson(byteArray, &err);
-    if (err.error != QJsonParseError::NoError) {
-        return;
+    mCityName = cityName;
+    if (userInitiated) {
+        mPrefetcher->recordSearch(cityCode);
     }
 
-    QJsonObject rootObj = doc.object();
-    qDebug() << rootObj.value("message").toString();
-
-    /****** 1. 解析日期和城市 ******/
-    mToday.date = rootObj.value("date").toString();
-    mToday.city = rootObj.value("cityInfo").toObject().value("city").toString();
-
-    /****** 2. 解析 yesterday ******/
-    QJsonObject objData = rootObj.value("data").toObject();
-    QJsonObject objYesterday = objData.value("yesterday").toObject();
-
-    mDay[0].week = objYesterday.value("week").toString();
-    mDay[0].date = objYesterday.value("ymd").toString();
-
-    mDay[0].type = objYesterday.value("type").toString();
-
-    // 解析 高、低温 数据
-    QString s;
-    s = objYesterday.value("high").toString().split(" ").at(1);
-    s = s.left(s.length() - 1);
-    mDay[0].high = s.toInt();
-
-    s = objYesterday.value("low").toString().split(" ").at(1);
-    s = s.left(s.length() - 1);
-    mDay[0].low = s.toInt();
-
-    // 解析 风向、风力 数据
-    mDay[0].fx = objYesterday.value("fx").toString();
-    mDay[0].fl = objYesterday.value("fl").toString();
-
-    // 解析 污染指数 aqi 数据
-    mDay[0].aqi = objYesterday.value("aqi").toDouble();
-
-    /****** 3. 解析预测 5 天的数据 ******/
-    QJsonArray forecastArr = objData.value("forecast").toArray();
+    // 预取命中则直接使用缓存，不再发请求；缓存的数据无法使用时删除并重新请求
+    QByteArray cached;
+    if (mPrefetcher->lookup(cityCode, cached)) {
+        if (parseJson(cached)) {
+            return;
+        }
+        mPrefetcher->remove(cityCode);
+    }
 
-    for (int i = 0; i < 5; i++) {
-        QJsonObject objForecast = forecastArr[i].toObject();
-        mDay[i + 1].week = objForecast.value("week").toString();
-        mDay[i + 1].date = objForecast.value("ymd").toString();
+    // 用户请求优先，预取器让路直到 onReplied
+    ProfileScope fetchScope(StageFetch);
+    mPrefetcher->pause();
+    mNetAccessManager->get(QNetworkRequest(WeatherTool::getWeatherUrl(cityCode)));
+}
 
-        // 天气类型
-        mDay[i + 1].type = objForecast.value("type").toString();
+void MainWindow::setQuiet(bool quiet) {
+    mQuiet = quiet;
+    mPrefetcher->setEnabled(!quiet);
+}
 
-        // 高温、低温
-        QString s;
-        s = objForecast.value("high").toString().split(" ").at(1);
-        s = s.left(s.length() - 1);
-        mDay[i + 1].high = s.toInt();
+int MainWindow::successCount() const {
+    return mSuccessCount;
+}
 
-        s = objForecast.value("low").toString().split(" ").at(1);
-        s = s.left(s.length() - 1);
-        mDay[i + 1].low = s.toInt();
+int MainWindow::failureCount() const {
+    return mFailureCount;
+}
 
-        // 风向、风力 数据
-        mDay[i + 1].fx = objForecast.value("fx").toString();
-        mDay[i + 1].fl = objForecast.value("fl").toString();
+// 刷新当前城市：丢弃缓存后和搜索一样查询城市编码、查缓存（未命中）、发请求，各阶段都会经过
+void MainWindow::refresh() {
+    mPrefetcher->remove(mToday.cityCode);
+    getWeatherInfo(mCityName, false);
+}
 
-        // 污染指数 aqi 数据
-        mDay[i + 1].aqi = objForecast.value("aqi").toDouble();
+// 解析天气数据并更新 UI，数据无效时返回 false
+bool MainWindow::parseJson(QByteArray &byteArray) {
+    {
+        ProfileScope scope(StageParse);
+        if (!WeatherTool::parseWeather(byteArray, mToday, mDay)) {
+            return false;
+        }
     }
 
-    /****** 4. 解析今天的数据 ******/
-    mToday.ganmao = objData.value("ganmao").toString();
-    mToday.wendu = objData.value("wendu").toString();
-    mToday.shidu = objData.value("shidu").toString();
-    mToday.pm25 = objData.value("pm25").toInt();
-    mToday.quality = objData.value("quality").toString();
+    ProfileScope scope(StageUpdateUI);
 
-    /****** 5. forecast 中第一个数组元素，也是今天的数据 ******/
-    mToday.type = mDay[1].type;
-
-    mToday.fx = mDay[1].fx;
-    mToday.fl = mDay[1].fl;
-
-    mToday.high = mDay[1].high;
-    mToday.low = mDay[1].low;
-
-    /****** 6. 更新 UI ******/
+    /****** 1. 更新 UI ******/
     updateUI();
 
-    /****** 7. 更新温度曲线图 ******/
+    /****** 2. 更新预警和地区汇总 ******/
+    checkAlerts(mToday.cityCode, mDay);
+    updateRegion(mToday.cityCode, mDay);
+    updateCityToolTip();
+
+    /****** 3. 更新温度曲线图 ******/
     ui->lblHighCurve->update();
     ui->lblLowCurve->update();
+    if (!mReady) {
+        mPaintPending = 1 | 2;
+    }
+    return true;
 }
 
 void MainWindow::weatherType() {
@@ -297,19 +288,100 @@ void MainWindow::updateUI() {
     }
 }
 
+// 计算预警（从今天开始的 5 天）
+void MainWindow::checkAlerts(const QString &cityCode, const Day *days) {
+    int high[5], low[5], aqi[5];
+    uint8_t types[5];
+    for (int i = 0; i < 5; i++) {
+        high[i] = days[i + 1].high;
+        low[i] = days[i + 1].low;
+        aqi[i] = days[i + 1].aqi;
+        types[i] = WeatherAlertEngine::typeFlags(days[i + 1].type);
+    }
+    mAlertEngine.updateCity(cityCode, high, low, aqi, types, 5);
+
+    // 新产生的预警记录日志（同一预警在解除前只记录一次）
+    // evaluate() 返回所有需要重算的城市的预警，只有本城市的预警能查到日期，其他城市记录第几天
+    QList<AlertEvent> events = mAlertEngine.evaluate();
+    for (int i = 0; i < events.size(); i++) {
+        QString when = events[i].cityCode == cityCode ? days[events[i].day + 1].date
+                                                      : QString("day %1").arg(events[i].day);
+        qDebug() << "alert:" << events[i].cityCode << when << mAlertEngine.rule(events[i].ruleId).name;
+    }
+}
+
+// 更新城市所在省的汇总（从今天开始的 5 天）
+void MainWindow::updateRegion(const QString &cityCode, const Day *days) {
+    if (cityCode.isEmpty()) {
+        return;
+    }
+
+    // 只标记所在省需要重算，导出时再统一并行计算
+    mRegion.updateCity(cityCode, days + 1, 5);
+}
+
+// 城市名的提示：当前城市正在触发的所有预警，以及所在省的汇总
+void MainWindow::updateCityToolTip() {
+    QStringList lines;
+    QList<AlertEvent> fired = mAlertEngine.firedRules(mToday.cityCode);
+    for (int i = 0; i < fired.size(); i++) {
+        lines << mDay[fired[i].day + 1].date + " " + mAlertEngine.rule(fired[i].ruleId).name;
+    }
+
+    QString province = mRegion.provinceOf(mToday.cityCode);
+    if (!province.isEmpty()) {
+        // 读取汇总时才重算有变化的省
+        RegionSummary s = mRegion.summary(province);
+        lines << QString(u8"%1（已查看 %2 个城市）最高温 %3~%4°C，最低温 %5~%6°C，空气污染指数最高 %7")
+                     .arg(s.province)
+                     .arg(s.cityCount)
+                     .arg(s.minHigh)
+                     .arg(s.maxHigh)
+                     .arg(s.minLow)
+                     .arg(s.maxLow)
+                     .arg(s.worstAqi);
+    }
+    ui->lblCity->setToolTip(lines.join("\n"));
+}
+
 // 重写父类事件过滤器方法
+// 标签自身的绘制也在过滤器中完成，使曲线和标签的绘制都计入 paint 阶段
 bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
     if (watched == ui->lblHighCurve && event->type() == QEvent::Paint) {
-       paintHighCurve();
+       {
+           ProfileScope scope(StagePaint);
+           paintHighCurve();
+           watched->event(event);
+       }
+       paintDone(1);
+       return true;
     }
 
     if (watched == ui->lblLowCurve && event->type() == QEvent::Paint) {
-       paintLowCurve();
+       {
+           ProfileScope scope(StagePaint);
+           paintLowCurve();
+           watched->event(event);
+       }
+       paintDone(2);
+       return true;
     }
 
     return QWidget::eventFilter(watched, event);
 }
 
+// 第一次解析成功后两条曲线都绘制完，启动完成
+void MainWindow::paintDone(int curve) {
+    if (mReady || mPaintPending == 0) {
+        return;
+    }
+    mPaintPending &= ~curve;
+    if (mPaintPending == 0) {
+        mReady = true;
+        emit ready();
+    }
+}
+
 void MainWindow::paintHighCurve() {
     QPainter painter(ui->lblHighCurve);
 
@@ -431,6 +503,8 @@ void MainWindow::paintLowCurve() {
 // 接收服务端数据
 // 当 GET 请求完毕，服务器返回数据时 mNetAccessManager 会发射 finished 信号，进而调用 onReplied()
 void MainWindow::onReplied(QNetworkReply *reply) {
+    ProfileScope scope(StageFetch);
+
     // 响应的状态码为 200，表示请求成功
     int status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -440,31 +514,68 @@ void MainWindow::onReplied(QNetworkReply *reply) {
     qDebug() << "raw header:" << reply->rawHeaderList();     // header
 
     // 如果指定的城市编码不存在，就会报错
-    if (reply->error() != QNetworkReply::NoError || status_code != 200) {
-        QMessageBox::warning(this, u8"提示", u8"请求数据失败！", QMessageBox::Ok);
-    } else {
-        // 获取响应信息
-        QByteArray reply_data = reply->readAll();
-        QByteArray byteArray = QString(reply_data).toUtf8();
-        qDebug() << "read all:" << byteArray.data();
+    bool ok = false;
+    if (reply->error() == QNetworkReply::NoError && status_code == 200) {
+        // 获取响应信息（接口返回的就是 UTF-8，不必再经过 QString 转换；只记录长度，不打印整个响应）
+        QByteArray byteArray = reply->readAll();
+        qDebug() << "read all:" << byteArray.size() << "bytes";
+
+        ok = parseJson(byteArray);
+        if (ok) {
+            mPrefetcher->store(reply->url().path().section('/', -1), byteArray);
+        }
+    }
 
-        parseJson(byteArray);
+    if (ok) {
+        mSuccessCount++;
+    } else {
+        mFailureCount++;
+        // 压力测试时不弹窗，避免模态对话框在定时器下嵌套事件循环
+        if (!mQuiet) {
+            QMessageBox::warning(this, u8"提示", u8"请求数据失败！", QMessageBox::Ok);
+        }
     }
 
+    mPrefetcher->resume();
     reply->deleteLater();
 }
 
+// 后台预取到的城市也参与预警和地区汇总
+void MainWindow::onPrefetched(const QString &cityCode, const QByteArray &data) {
+    Today today;
+    Day days[6];
+    {
+        ProfileScope scope(StageParse);
+        if (!WeatherTool::parseWeather(data, today, days)) {
+            return;
+        }
+    }
+
+    ProfileScope scope(StageUpdateUI);
+    checkAlerts(cityCode, days);
+    updateRegion(cityCode, days);
+    // 预取的城市可能和当前城市同省，汇总会变化
+    updateCityToolTip();
+}
+
 // 城市搜索按钮
 void MainWindow::on_btnSearch_clicked() {
     QString cityName = ui->leCity->text();
-    getWeatherInfo(cityName);
+    getWeatherInfo(cityName, true);
+    // clear() 不会发出 textEdited，补全候选要手动清空，否则会一直占用预取预算
     ui->leCity->clear();
+    mPrefetcher->setCandidates(QStringList());
 }
 
 // 判断文本框中是否发生回车事件
 void MainWindow::on_leCity_returnPressed() {
     QString cityName = ui->leCity->text();
-    getWeatherInfo(cityName);
+    getWeatherInfo(cityName, true);
     ui->leCity->clear();
+    mPrefetcher->setCandidates(QStringList());
 }
 
+// 输入框文本变化
+void MainWindow::on_leCity_textEdited(const QString &text) {
+    mPrefetcher->setCandidates(WeatherTool::getCityCandidates(text, 3));
+}
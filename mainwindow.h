@@ -2,6 +2,10 @@
 #define MAINWINDOW_H
 
 #include "weatherdata.h"
+#include "weatherprefetcher.h"
+#include "weatheralert.h"
+#include "weatherregion.h"
+#include "weatherprofiler.h"
 #include <QLabel>
 #include <QMainWindow>
 #include <QMouseEvent>
@@ -14,6 +18,7 @@
 #include <QString>
 #include <QUrl>
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -36,16 +41,29 @@ public:
     MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
 
+    // 重新请求当前城市的天气（丢弃缓存，走完整的查询、请求流程）
+    void refresh();
+
+    // 不弹出请求失败的对话框，并停止后台预取（用于压力测试）
+    void setQuiet(bool quiet);
+    // 请求并解析成功 / 失败的次数
+    int successCount() const;
+    int failureCount() const;
+
+signals:
+    // 第一次请求解析成功并且两条温度曲线都已绘制（启动完成）
+    void ready();
+
 protected:
     // 重写父类方法
     void contextMenuEvent(QContextMenuEvent* event);
     void mousePressEvent(QMouseEvent* event);
     void mouseMoveEvent(QMouseEvent* event);
 
-    // 获取天气数据
-    void getWeatherInfo(QString cityCode);
+    // 获取天气数据，userInitiated 为用户主动搜索（计入预取器的搜索记录）
+    void getWeatherInfo(QString cityName, bool userInitiated);
     // 解析天气数据
-    void parseJson(QByteArray &byteArray);
+    bool parseJson(QByteArray &byteArray);
 
     //天气类型
     void weatherType();
@@ -53,30 +71,53 @@ protected:
     // 更新 UI
     void updateUI();
 
+    // 用城市的预报数据计算预警
+    void checkAlerts(const QString &cityCode, const Day *days);
+    // 用城市的预报数据更新所在省的汇总
+    void updateRegion(const QString &cityCode, const Day *days);
+    // 更新城市名的提示（预警和所在省的汇总）
+    void updateCityToolTip();
+
     // 重写父类的 eventFilter 方法
     bool eventFilter(QObject *watched, QEvent *event);
 
     // 绘制高低温曲线
     void paintHighCurve();
     void paintLowCurve();
+    // 一条曲线绘制完成（用于判断启动完成）
+    void paintDone(int curve);
 
 private slots:
     // 用于处理 HTTP 服务返回数据的槽函数
     void onReplied(QNetworkReply *reply);
+    // 预取器拿到数据
+    void onPrefetched(const QString &cityCode, const QByteArray &data);
     // 城市搜索按钮
     void on_btnSearch_clicked();
     // 判断文本框中是否发生回车事件，回车即搜索
     void on_leCity_returnPressed();
+    // 输入框文本变化时，把补全候选交给预取器
+    void on_leCity_textEdited(const QString &text);
 
 private:
     Ui::MainWindow* ui;
 
     QMenu* mExitMenu;   // 右键退出的菜单
     QAction* mExitAct;  // 退出的行为
+    QAction* mExportAct;  // 导出地区汇总的行为
     QPoint mOffset;     // 窗口移动时, 鼠标与窗口左上角的偏移
 
+    bool mQuiet;         // 不弹出失败对话框
+    bool mReady;         // 是否已经发出 ready()
+    int mPaintPending;   // 第一次解析成功后还没有绘制的曲线（1 最高温，2 最低温）
+    QString mCityName;   // 当前城市名，用于刷新
+    int mSuccessCount;   // 请求并解析成功的次数
+    int mFailureCount;   // 请求或解析失败的次数
+
     // 声明用于 HTTP 通信的指针对象
     QNetworkAccessManager *mNetAccessManager;
+    // 后台预取可能要查看的城市
+    WeatherPrefetcher *mPrefetcher;
 
     // 当天和未来 6 天的天气
     Today mToday;
@@ -96,5 +137,10 @@ private:
     QList<QLabel*> mFlList;
     // 天气对应的图标
     QMap<QString, QString> mTypeMap;
+
+    // 天气预警
+    WeatherAlertEngine mAlertEngine;
+    // 按省汇总
+    RegionAggregator mRegion;
 };
 #endif  // MAINWINDOW_H
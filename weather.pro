@@ -1,4 +1,4 @@
-QT       += core gui network
+QT       += core gui network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -10,14 +10,25 @@ CONFIG += c++17
 
 SOURCES += \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    weatherprefetcher.cpp \
+    weatheralert.cpp \
+    weatherregion.cpp \
+    weatherprofiler.cpp
 
 HEADERS += \
     mainwindow.h \
     weatherdata.h \
     weatherdata.h \
     weathertool.h \
-    weathertool.h
+    weathertool.h \
+    weatherprefetcher.h \
+    weatheralert.h \
+    weatherregion.h \
+    weatherprofiler.h
+
+# 内存分析模式读取进程内存需要 psapi
+win32: LIBS += -lpsapi
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,273 @@
+﻿#include "weatheralert.h"
+
+#include <algorithm>
+#include <cstring>
+
+// 以下四个计算函数都是对一个城市 ALERT_DAYS 个元素的定长循环，
+// 不提前退出、没有分支，便于编译器展开并向量化
+
+// withinDays 天内是否有 aqi > limit
+static inline bool kernelAqiAbove(const int16_t* aqi, int16_t limit, int within) {
+    int hit = 0;
+    for (int d = 0; d < ALERT_DAYS; d++) {
+        hit |= (d < within) & (aqi[d] > limit);
+    }
+    return hit != 0;
+}
+
+// withinDays 天内是否有最高温 >= limit
+static inline bool kernelHighAbove(const int16_t* high, int16_t limit, int within) {
+    int hit = 0;
+    for (int d = 0; d < ALERT_DAYS; d++) {
+        hit |= (d < within) & (high[d] >= limit);
+    }
+    return hit != 0;
+}
+
+// withinDays 天内是否有相邻两天的最低温下降 >= delta
+static inline bool kernelLowDrop(const int16_t* low, int16_t delta, int within) {
+    int hit = 0;
+    for (int d = 0; d < ALERT_DAYS - 1; d++) {
+        hit |= (d + 1 < within) & (low[d] - low[d + 1] >= delta);
+    }
+    return hit != 0;
+}
+
+// withinDays 天内是否出现 mask 中的天气类型
+static inline bool kernelTypeMatch(const uint8_t* types, uint8_t mask, int within) {
+    int hit = 0;
+    for (int d = 0; d < ALERT_DAYS; d++) {
+        hit |= (d < within) & ((types[d] & mask) != 0);
+    }
+    return hit != 0;
+}
+
+static inline int16_t clampInt16(int v) {
+    return int16_t(std::max(-32768, std::min(32767, v)));
+}
+
+WeatherAlertEngine::WeatherAlertEngine() {}
+
+int WeatherAlertEngine::addRule(const AlertRule& rule) {
+    if (mRules.size() >= ALERT_MAX_RULES) {
+        return -1;
+    }
+    mRules << rule;
+
+    // 新规则需要对所有城市计算一次
+    for (int i = 0; i < mCityCodes.size(); i++) {
+        markDirty(i);
+    }
+    return mRules.size() - 1;
+}
+
+void WeatherAlertEngine::setRuleActive(int ruleId, bool active) {
+    if (ruleId < 0 || ruleId >= mRules.size() || mRules[ruleId].active == active) {
+        return;
+    }
+    mRules[ruleId].active = active;
+
+    uint64_t bit = uint64_t(1) << ruleId;
+    for (int i = 0; i < mCityCodes.size(); i++) {
+        // 停用的规则清除触发状态，重新启用时可以再次报警
+        mFired[i] &= ~bit;
+        markDirty(i);
+    }
+}
+
+const AlertRule& WeatherAlertEngine::rule(int ruleId) const {
+    return mRules[ruleId];
+}
+
+void WeatherAlertEngine::updateCity(const QString& cityCode, const int* high, const int* low, const int* aqi,
+                                    const uint8_t* types, int days) {
+    days = std::max(0, std::min(days, ALERT_DAYS));
+
+    // 补齐到 ALERT_DAYS：温度重复最后一天（相邻差为 0），aqi 和天气类型补 0，都不会触发规则
+    int16_t newHigh[ALERT_DAYS];
+    int16_t newLow[ALERT_DAYS];
+    int16_t newAqi[ALERT_DAYS];
+    uint8_t newType[ALERT_DAYS];
+    for (int d = 0; d < ALERT_DAYS; d++) {
+        int src = std::min(d, days - 1);
+        newHigh[d] = src < 0 ? 0 : clampInt16(high[src]);
+        newLow[d] = src < 0 ? 0 : clampInt16(low[src]);
+        newAqi[d] = d < days ? clampInt16(aqi[d]) : 0;
+        newType[d] = d < days ? types[d] : uint8_t(TypeNone);
+    }
+
+    int city = cityIndex(cityCode);
+    size_t offset = size_t(city) * ALERT_DAYS;
+
+    // 数据没有变化就不用重新计算
+    if (mDays[city] == days &&
+        memcmp(&mHigh[offset], newHigh, sizeof(newHigh)) == 0 &&
+        memcmp(&mLow[offset], newLow, sizeof(newLow)) == 0 &&
+        memcmp(&mAqi[offset], newAqi, sizeof(newAqi)) == 0 &&
+        memcmp(&mType[offset], newType, sizeof(newType)) == 0) {
+        return;
+    }
+
+    memcpy(&mHigh[offset], newHigh, sizeof(newHigh));
+    memcpy(&mLow[offset], newLow, sizeof(newLow));
+    memcpy(&mAqi[offset], newAqi, sizeof(newAqi));
+    memcpy(&mType[offset], newType, sizeof(newType));
+    mDays[city] = int16_t(days);
+    markDirty(city);
+}
+
+QList<AlertEvent> WeatherAlertEngine::evaluate() {
+    QList<AlertEvent> events;
+
+    for (size_t i = 0; i < mDirtyList.size(); i++) {
+        int city = mDirtyList[i];
+        size_t offset = size_t(city) * ALERT_DAYS;
+        const int16_t* aqi = &mAqi[offset];
+        const int16_t* high = &mHigh[offset];
+        const int16_t* low = &mLow[offset];
+        const uint8_t* types = &mType[offset];
+
+        uint64_t fired = 0;
+        for (int r = 0; r < mRules.size(); r++) {
+            const AlertRule& rule = mRules[r];
+            if (!rule.active) {
+                continue;
+            }
+
+            int within = std::min<int>(rule.withinDays, mDays[city]);
+            bool hit = false;
+            switch (rule.kind) {
+            case AlertRule::AqiAbove:
+                hit = kernelAqiAbove(aqi, clampInt16(rule.threshold), within);
+                break;
+            case AlertRule::HighAbove:
+                hit = kernelHighAbove(high, clampInt16(rule.threshold), within);
+                break;
+            case AlertRule::LowDrop:
+                hit = kernelLowDrop(low, clampInt16(rule.threshold), within);
+                break;
+            case AlertRule::TypeMatch:
+                hit = kernelTypeMatch(types, rule.typeMask, within);
+                break;
+            }
+            fired |= uint64_t(hit) << r;
+        }
+
+        // 只报告新触发的规则，已经在触发状态的不重复报告
+        uint64_t newly = fired & ~mFired[city];
+        for (int r = 0; newly != 0; r++, newly >>= 1) {
+            if (newly & 1) {
+                AlertEvent event;
+                event.cityCode = mCityCodes[city];
+                event.ruleId = r;
+                event.day = firstDay(mRules[r], city);
+                events << event;
+            }
+        }
+
+        mFired[city] = fired;
+        mDirty[city] = 0;
+    }
+    mDirtyList.clear();
+
+    return events;
+}
+
+QList<AlertEvent> WeatherAlertEngine::firedRules(const QString& cityCode) const {
+    QList<AlertEvent> events;
+    QMap<QString, int>::const_iterator it = mCityIndex.constFind(cityCode);
+    if (it == mCityIndex.constEnd()) {
+        return events;
+    }
+
+    int city = it.value();
+    uint64_t fired = mFired[city];
+    for (int r = 0; fired != 0; r++, fired >>= 1) {
+        if (fired & 1) {
+            AlertEvent event;
+            event.cityCode = cityCode;
+            event.ruleId = r;
+            event.day = firstDay(mRules[r], city);
+            events << event;
+        }
+    }
+    return events;
+}
+
+uint8_t WeatherAlertEngine::typeFlags(const QString& type) {
+    uint8_t flags = TypeNone;
+    if (type.contains(u8"暴雨")) {
+        flags |= TypeRainstorm;
+    }
+    if (type.contains(u8"暴雪")) {
+        flags |= TypeBlizzard;
+    }
+    if (type.contains(u8"沙尘暴")) {
+        flags |= TypeSandstorm;
+    }
+    if (type.contains(u8"冰雹")) {
+        flags |= TypeHail;
+    }
+    if (type.contains(u8"冻雨")) {
+        flags |= TypeFreezingRain;
+    }
+    return flags;
+}
+
+int WeatherAlertEngine::cityIndex(const QString& cityCode) {
+    QMap<QString, int>::const_iterator it = mCityIndex.constFind(cityCode);
+    if (it != mCityIndex.constEnd()) {
+        return it.value();
+    }
+
+    int city = mCityCodes.size();
+    mCityIndex.insert(cityCode, city);
+    mCityCodes << cityCode;
+
+    mHigh.resize(mHigh.size() + ALERT_DAYS, 0);
+    mLow.resize(mLow.size() + ALERT_DAYS, 0);
+    mAqi.resize(mAqi.size() + ALERT_DAYS, 0);
+    mType.resize(mType.size() + ALERT_DAYS, TypeNone);
+    mDays.push_back(0);
+    mFired.push_back(0);
+    mDirty.push_back(0);
+    return city;
+}
+
+void WeatherAlertEngine::markDirty(int city) {
+    if (!mDirty[city]) {
+        mDirty[city] = 1;
+        mDirtyList.push_back(city);
+    }
+}
+
+// 只在规则新触发时调用，找出第一次满足条件的那一天
+int WeatherAlertEngine::firstDay(const AlertRule& rule, int city) const {
+    size_t offset = size_t(city) * ALERT_DAYS;
+    int within = std::min<int>(rule.withinDays, mDays[city]);
+    for (int d = 0; d < within; d++) {
+        switch (rule.kind) {
+        case AlertRule::AqiAbove:
+            if (mAqi[offset + d] > rule.threshold) {
+                return d;
+            }
+            break;
+        case AlertRule::HighAbove:
+            if (mHigh[offset + d] >= rule.threshold) {
+                return d;
+            }
+            break;
+        case AlertRule::LowDrop:
+            if (d + 1 < within && mLow[offset + d] - mLow[offset + d + 1] >= rule.threshold) {
+                return d + 1;
+            }
+            break;
+        case AlertRule::TypeMatch:
+            if (mType[offset + d] & rule.typeMask) {
+                return d;
+            }
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+﻿#ifndef WEATHERALERT_H
+#define WEATHERALERT_H
+
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <vector>
+
+#define ALERT_DAYS 16       // 每个城市预留的天数（最多 15 天预报，补齐到 16 便于向量化）
+#define ALERT_MAX_RULES 64  // 规则数上限（每个城市用一个 64 位掩码记录已触发的规则）
+
+// 需要关注的天气类型，一个城市一天的天气可能同时带有多个标志
+enum WeatherTypeFlag : uint8_t {
+    TypeNone = 0,
+    TypeRainstorm = 1 << 0,     // 暴雨类
+    TypeBlizzard = 1 << 1,      // 暴雪类
+    TypeSandstorm = 1 << 2,     // 沙尘暴类
+    TypeHail = 1 << 3,          // 冰雹
+    TypeFreezingRain = 1 << 4,  // 冻雨
+};
+
+// 预警规则
+class AlertRule {
+public:
+    enum Kind {
+        AqiAbove,   // withinDays 天内 aqi > threshold
+        HighAbove,  // withinDays 天内最高温 >= threshold
+        LowDrop,    // withinDays 天内相邻两天的最低温下降 >= threshold
+        TypeMatch,  // withinDays 天内出现 typeMask 中的任一天气类型
+    };
+
+    AlertRule(Kind kind = AqiAbove, int threshold = 0, int withinDays = ALERT_DAYS, uint8_t typeMask = TypeNone, QString name = "")
+        : kind(kind), threshold(threshold), withinDays(withinDays), typeMask(typeMask), name(name), active(true) {}
+
+    Kind kind;
+    int threshold;
+    int withinDays;
+    uint8_t typeMask;
+    QString name;
+    bool active;
+};
+
+// 预警事件：某城市从“未触发”变为“触发”某条规则时产生一次
+class AlertEvent {
+public:
+    QString cityCode;
+    int ruleId;
+    int day;  // 第一次满足条件的那一天（相对于传入数据的第 0 天）
+};
+
+// 多城市阈值预警引擎
+// 各城市的数据按固定步长 ALERT_DAYS 连续存放在几个 int16 数组中（结构体数组转为数组结构体），
+// 每条规则对一个城市的计算都是定长、无分支的循环，编译器可以直接向量化
+// 只有数据发生变化的城市才会重新计算，同一城市同一规则在条件解除前只报一次
+class WeatherAlertEngine {
+public:
+    WeatherAlertEngine();
+
+    // 添加规则，返回规则编号；规则已满返回 -1
+    int addRule(const AlertRule& rule);
+    void setRuleActive(int ruleId, bool active);
+    const AlertRule& rule(int ruleId) const;
+
+    // 更新一个城市的数据（days 天，从今天开始），数据没有变化时不会重新计算
+    void updateCity(const QString& cityCode, const int* high, const int* low, const int* aqi,
+                    const uint8_t* types, int days);
+
+    // 计算所有有变化的城市，返回新产生的预警
+    QList<AlertEvent> evaluate();
+
+    // 某城市当前处于触发状态的所有规则（不论是否已经报告过），用于显示
+    QList<AlertEvent> firedRules(const QString& cityCode) const;
+
+    // 天气类型文字转为标志位
+    static uint8_t typeFlags(const QString& type);
+
+private:
+    int cityIndex(const QString& cityCode);
+    void markDirty(int city);
+    int firstDay(const AlertRule& rule, int city) const;
+
+    QList<AlertRule> mRules;
+    QMap<QString, int> mCityIndex;
+    QStringList mCityCodes;
+
+    // 连续存放的数据，第 i 个城市占 [i * ALERT_DAYS, (i + 1) * ALERT_DAYS)
+    std::vector<int16_t> mHigh;
+    std::vector<int16_t> mLow;
+    std::vector<int16_t> mAqi;
+    std::vector<uint8_t> mType;
+    std::vector<int16_t> mDays;
+
+    std::vector<uint64_t> mFired;  // 每个城市当前处于触发状态的规则
+    std::vector<uint8_t> mDirty;
+    std::vector<int> mDirtyList;
+};
+
+#endif // WEATHERALERT_H
@@ -1,8 +1,6 @@
 ﻿#ifndef WEATHERDATA_H
 #define WEATHERDATA_H
 
-#endif // WEATHERDATA_H
-
 #include <QString>
 
 class Today {
@@ -10,6 +8,7 @@ public:
     Today() {
         date = "2023-12-01";
         city = u8"广州";
+        cityCode = "101280101";
 
         ganmao = u8"感冒指数";
 
@@ -29,6 +28,7 @@ public:
 
     QString date;
     QString city;
+    QString cityCode;
 
     QString ganmao;
 
@@ -76,3 +76,5 @@ public:
 
     int aqi; // 空气污染系数
 };
+
+#endif // WEATHERDATA_H
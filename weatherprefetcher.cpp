@@ -0,0 +1,270 @@
+﻿#include "weatherprefetcher.h"
+#include "weatherprofiler.h"
+#include "weathertool.h"
+
+#include <QDebug>
+#include <QSettings>
+#include <QVariantMap>
+#include <algorithm>
+
+WeatherPrefetcher::WeatherPrefetcher(QObject* parent)
+    : QObject(parent), mPending(nullptr), mPaused(0),
+      mHits(0), mMisses(0), mPrefetchHits(0), mPrefetched(0) {
+    mNetAccessManager = new QNetworkAccessManager(this);
+    connect(mNetAccessManager, &QNetworkAccessManager::finished, this, &WeatherPrefetcher::onPrefetchReplied);
+
+    // 读取上次运行记录的最近搜索和常看城市
+    QSettings settings("Robot-Yue", "weather");
+    mRecent = settings.value("prefetch/recent").toStringList();
+    QVariantMap counts = settings.value("prefetch/viewCount").toMap();
+    for (QVariantMap::const_iterator it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        mViewCount.insert(it.key(), it.value().toInt());
+    }
+
+    mTimer = new QTimer(this);
+    mTimer->setInterval(PREFETCH_INTERVAL_MS);
+    connect(mTimer, &QTimer::timeout, this, &WeatherPrefetcher::onTick);
+    mTimer->start();
+}
+
+WeatherPrefetcher::~WeatherPrefetcher() {
+    qDebug() << "prefetch hit rate:" << hitRate()
+             << "hits:" << mHits << "misses:" << mMisses
+             << "prefetched:" << mPrefetched << "prefetch hits:" << mPrefetchHits;
+}
+
+bool WeatherPrefetcher::lookup(const QString& cityCode, QByteArray& data) {
+    if (!isFresh(cityCode)) {
+        mMisses++;
+        qDebug() << "prefetch miss:" << cityCode << "hit rate:" << hitRate();
+        return false;
+    }
+
+    CacheEntry& entry = mCache[cityCode];
+    mHits++;
+    if (entry.prefetched) {
+        // 每条预取数据只统计一次
+        mPrefetchHits++;
+        entry.prefetched = false;
+    }
+    data = entry.data;
+    qDebug() << "prefetch hit:" << cityCode << "hit rate:" << hitRate();
+    return true;
+}
+
+void WeatherPrefetcher::store(const QString& cityCode, const QByteArray& data) {
+    CacheEntry entry;
+    entry.data = data;
+    entry.fetched = QDateTime::currentDateTime();
+    entry.prefetched = false;
+    mCache.insert(cityCode, entry);
+    mFailures.remove(cityCode);
+    evict();
+}
+
+void WeatherPrefetcher::remove(const QString& cityCode) {
+    mCache.remove(cityCode);
+}
+
+void WeatherPrefetcher::recordSearch(const QString& cityCode) {
+    mRecent.removeAll(cityCode);
+    mRecent.prepend(cityCode);
+    while (mRecent.size() > PREFETCH_RECENT_SIZE) {
+        mRecent.removeLast();
+    }
+    mViewCount[cityCode]++;
+
+    QVariantMap counts;
+    for (QMap<QString, int>::const_iterator it = mViewCount.constBegin(); it != mViewCount.constEnd(); ++it) {
+        counts.insert(it.key(), it.value());
+    }
+    QSettings settings("Robot-Yue", "weather");
+    settings.setValue("prefetch/recent", mRecent);
+    settings.setValue("prefetch/viewCount", counts);
+}
+
+void WeatherPrefetcher::setCandidates(const QStringList& cityCodes) {
+    mCandidates = cityCodes;
+}
+
+// 用户请求优先：中止进行中的预取，并暂停调度
+void WeatherPrefetcher::pause() {
+    mPaused++;
+    if (mPending) {
+        QNetworkReply* reply = mPending;
+        mPending = nullptr;
+        reply->abort();
+    }
+}
+
+void WeatherPrefetcher::resume() {
+    if (mPaused > 0) {
+        mPaused--;
+    }
+}
+
+void WeatherPrefetcher::setEnabled(bool enabled) {
+    if (enabled) {
+        mTimer->start();
+        return;
+    }
+
+    mTimer->stop();
+    if (mPending) {
+        QNetworkReply* reply = mPending;
+        mPending = nullptr;
+        reply->abort();
+    }
+}
+
+double WeatherPrefetcher::hitRate() const {
+    int total = mHits + mMisses;
+    return total == 0 ? 0.0 : double(mHits) / total;
+}
+
+void WeatherPrefetcher::onTick() {
+    evict();
+
+    if (mPaused > 0 || mPending) {
+        return;
+    }
+
+    QStringList cities = predict();
+    if (cities.isEmpty() || !takeBudget()) {
+        return;
+    }
+
+    QNetworkRequest request(WeatherTool::getWeatherUrl(cities.first()));
+    request.setPriority(QNetworkRequest::LowPriority);
+    mPending = mNetAccessManager->get(request);
+}
+
+void WeatherPrefetcher::onPrefetchReplied(QNetworkReply* reply) {
+    ProfileScope scope(StageFetch);
+
+    if (reply == mPending) {
+        mPending = nullptr;
+    }
+
+    int status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() == QNetworkReply::OperationCanceledError) {
+        // 被用户请求打断的预取不计入预算
+        if (!mBudgetStamps.isEmpty()) {
+            mBudgetStamps.removeLast();
+        }
+    } else {
+        QString cityCode = reply->url().path().section('/', -1);
+        QByteArray data;
+        bool ok = false;
+        if (reply->error() == QNetworkReply::NoError && status_code == 200) {
+            // HTTP 200 也可能是接口报错（json 中的 status 不是 200），解析成功才写入缓存
+            data = reply->readAll();
+            Today today;
+            Day days[6];
+            ProfileScope parseScope(StageParse);
+            ok = WeatherTool::parseWeather(data, today, days);
+        }
+
+        if (ok) {
+            store(cityCode, data);
+            mCache[cityCode].prefetched = true;
+            mPrefetched++;
+            emit prefetched(cityCode, mCache[cityCode].data);
+        } else {
+            // 失败的城市指数退避，避免同一个城市反复失败耗尽预算
+            Failure& failure = mFailures[cityCode];
+            failure.count++;
+            qint64 backoff = qMin<qint64>(qint64(PREFETCH_BACKOFF_MS) << qMin(failure.count - 1, 16),
+                                          PREFETCH_BACKOFF_MAX_MS);
+            failure.retryAt = QDateTime::currentMSecsSinceEpoch() + backoff;
+            qDebug() << "prefetch failed:" << cityCode << "retry in" << backoff / 1000 << "s";
+        }
+    }
+
+    reply->deleteLater();
+}
+
+QStringList WeatherPrefetcher::predict() const {
+    QStringList ordered = mCandidates;
+
+    // 常看城市按查看次数从多到少
+    QList<QPair<int, QString>> top;
+    for (QMap<QString, int>::const_iterator it = mViewCount.constBegin(); it != mViewCount.constEnd(); ++it) {
+        top << qMakePair(it.value(), it.key());
+    }
+    std::sort(top.begin(), top.end(), [](const QPair<int, QString>& a, const QPair<int, QString>& b) {
+        return a.first > b.first;
+    });
+    for (int i = 0; i < top.size(); i++) {
+        ordered << top[i].second;
+    }
+
+    ordered << mRecent;
+
+    QStringList cities;
+    for (int i = 0; i < ordered.size() && cities.size() < PREFETCH_TOP_SIZE; i++) {
+        const QString& code = ordered[i];
+        if (!code.isEmpty() && !cities.contains(code) && !isFresh(code) && !isBackingOff(code)) {
+            cities << code;
+        }
+    }
+    return cities;
+}
+
+bool WeatherPrefetcher::isFresh(const QString& cityCode) const {
+    QMap<QString, CacheEntry>::const_iterator it = mCache.constFind(cityCode);
+    if (it == mCache.constEnd()) {
+        return false;
+    }
+    return it.value().fetched.secsTo(QDateTime::currentDateTime()) < PREFETCH_CACHE_TTL_SECS;
+}
+
+bool WeatherPrefetcher::isBackingOff(const QString& cityCode) const {
+    QMap<QString, Failure>::const_iterator it = mFailures.constFind(cityCode);
+    return it != mFailures.constEnd() && it.value().retryAt > QDateTime::currentMSecsSinceEpoch();
+}
+
+void WeatherPrefetcher::evict() {
+    QDateTime now = QDateTime::currentDateTime();
+    for (QMap<QString, CacheEntry>::iterator it = mCache.begin(); it != mCache.end();) {
+        if (it.value().fetched.secsTo(now) >= PREFETCH_CACHE_TTL_SECS) {
+            it = mCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // 超出上限时删除最早拉取的
+    while (mCache.size() > PREFETCH_CACHE_SIZE) {
+        QMap<QString, CacheEntry>::iterator oldest = mCache.begin();
+        for (QMap<QString, CacheEntry>::iterator it = mCache.begin(); it != mCache.end(); ++it) {
+            if (it.value().fetched < oldest.value().fetched) {
+                oldest = it;
+            }
+        }
+        mCache.erase(oldest);
+    }
+
+    // 退避早已结束的失败记录也不再需要
+    qint64 nowMs = now.toMSecsSinceEpoch();
+    for (QMap<QString, Failure>::iterator it = mFailures.begin(); it != mFailures.end();) {
+        if (nowMs - it.value().retryAt > PREFETCH_BACKOFF_MAX_MS) {
+            it = mFailures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// 滑动窗口限额：窗口内的预取请求数不超过 PREFETCH_BUDGET
+bool WeatherPrefetcher::takeBudget() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    while (!mBudgetStamps.isEmpty() && now - mBudgetStamps.first() > PREFETCH_BUDGET_WINDOW_MS) {
+        mBudgetStamps.removeFirst();
+    }
+    if (mBudgetStamps.size() >= PREFETCH_BUDGET) {
+        return false;
+    }
+    mBudgetStamps << now;
+    return true;
+}
@@ -0,0 +1,104 @@
+﻿#ifndef WEATHERPREFETCHER_H
+#define WEATHERPREFETCHER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+#define PREFETCH_INTERVAL_MS 2000         // 预取调度的间隔（同时也起到输入防抖的作用）
+#define PREFETCH_BUDGET 8                 // 预算窗口内最多发出的预取请求数
+#define PREFETCH_BUDGET_WINDOW_MS 600000  // 预算窗口：10 分钟
+#define PREFETCH_CACHE_TTL_SECS 1800      // 缓存有效期：30 分钟
+#define PREFETCH_RECENT_SIZE 10           // 记住的最近搜索城市数
+#define PREFETCH_TOP_SIZE 5               // 每次最多预测的城市数
+#define PREFETCH_CACHE_SIZE 32            // 缓存最多保留的城市数
+#define PREFETCH_BACKOFF_MS 60000         // 预取失败后的首次退避时间：1 分钟，之后每次失败翻倍
+#define PREFETCH_BACKOFF_MAX_MS 3600000   // 退避时间上限：1 小时
+
+// 低优先级的天气预取器
+// 根据最近搜索、常看城市和输入框的补全候选，在后台提前拉取天气数据并缓存
+// 用户主动发起请求时立即让路（pause），请求返回后再继续（resume）
+class WeatherPrefetcher : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WeatherPrefetcher(QObject* parent = nullptr);
+    ~WeatherPrefetcher();
+
+    // 查询缓存，命中返回 true 并输出数据（同时统计命中率）
+    bool lookup(const QString& cityCode, QByteArray& data);
+    // 用户请求返回的数据也写入缓存（调用方保证数据已解析成功）
+    void store(const QString& cityCode, const QByteArray& data);
+    // 删除一个城市的缓存（缓存的数据无法使用时）
+    void remove(const QString& cityCode);
+
+    // 记录一次用户搜索（最近搜索 + 常看城市计数）
+    void recordSearch(const QString& cityCode);
+    // 输入框当前文本对应的补全候选城市编码
+    void setCandidates(const QStringList& cityCodes);
+
+    // 用户请求发出时让路，返回后恢复（可嵌套）
+    void pause();
+    void resume();
+    // 停止 / 恢复后台预取（压力测试时停止，避免请求数随本机的搜索记录变化）
+    void setEnabled(bool enabled);
+
+    // 缓存命中率
+    double hitRate() const;
+
+signals:
+    // 预取到一个城市的数据
+    void prefetched(const QString& cityCode, const QByteArray& data);
+
+private slots:
+    void onTick();
+    void onPrefetchReplied(QNetworkReply* reply);
+
+private:
+    struct CacheEntry {
+        QByteArray data;
+        QDateTime fetched;
+        bool prefetched;  // 是否由预取得到（用于统计预取的有效性）
+    };
+
+    // 按优先级给出下一批值得预取的城市：补全候选 > 常看城市 > 最近搜索
+    QStringList predict() const;
+    bool isFresh(const QString& cityCode) const;
+    bool isBackingOff(const QString& cityCode) const;
+    bool takeBudget();
+    // 删除过期的缓存和失败记录，并把缓存限制在 PREFETCH_CACHE_SIZE 以内
+    void evict();
+
+    QNetworkAccessManager* mNetAccessManager;  // 独立的网络管理器，不干扰用户请求的 finished 信号
+    QNetworkReply* mPending;                   // 进行中的预取请求，同一时间最多一个
+    QTimer* mTimer;
+    int mPaused;
+
+    QMap<QString, CacheEntry> mCache;
+    QStringList mRecent;             // 最近搜索，最新的在前
+    QMap<QString, int> mViewCount;   // 每个城市被查看的次数（持久化）
+    QStringList mCandidates;
+    QList<qint64> mBudgetStamps;     // 预算窗口内已发出的预取请求时间
+
+    struct Failure {
+        int count;       // 连续失败次数
+        qint64 retryAt;  // 在此时间之前不再预取
+    };
+    QMap<QString, Failure> mFailures;
+
+    int mHits;
+    int mMisses;
+    int mPrefetchHits;  // 命中的缓存中由预取得到的次数
+    int mPrefetched;    // 预取成功的次数
+};
+
+#endif // WEATHERPREFETCHER_H
@@ -0,0 +1,339 @@
+﻿#include "weatherprofiler.h"
+
+#include <QDebug>
+#include <QStringList>
+#include <QtGlobal>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX  // 避免 windows.h 的 min / max 宏破坏 std::max
+#endif
+#include <windows.h>
+#include <psapi.h>
+#if defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+// Qt 容器（QString、QByteArray、QJson 等）的缓冲区直接用 malloc 分配，要在 malloc 一级统计才能覆盖：
+// MSVC 调试版用 _CrtSetAllocHook，glibc 上替换 malloc / calloc / realloc / free；
+// 其他平台（如 MSVC 发布版）只能统计 operator new
+#if (defined(Q_OS_WIN) && defined(_DEBUG)) || defined(__GLIBC__)
+#define PROFILE_MALLOC_HOOK
+#endif
+
+#define PROFILE_MAX_SAMPLES 4096  // 计算稳定状态 RSS 时保留的最近采样数（环形缓冲）
+
+// operator new 可能在任何静态对象构造之前被调用，这里只用零初始化即可使用的变量
+static std::atomic<bool> sEnabled(false);
+static thread_local ProfileStage tStage = StageOther;
+static std::atomic<unsigned long long> sAllocs[StageCount];
+static std::atomic<unsigned long long> sBytes[StageCount];
+
+// 以下只在主线程的 endCycle / checkBudgets 中访问
+static unsigned long long sLastAllocs[StageCount];
+static unsigned long long sLastBytes[StageCount];
+static unsigned long long sPeakAllocs[StageCount];
+static unsigned long long sPeakBytes[StageCount];
+static unsigned long long sBudgetAllocs[StageCount];
+static unsigned long long sBudgetBytes[StageCount];
+static unsigned long long sBudgetRss;
+static size_t sRss[PROFILE_MAX_SAMPLES];  // 启动之后的 RSS 采样，环形缓冲
+static unsigned long long sRssCount;      // 启动之后的采样总数
+static size_t sStartupRss;
+static size_t sLastRss;
+static size_t sPeakRss;
+static int sCycles;
+
+#if defined(Q_OS_WIN) && defined(_DEBUG)
+static int allocHook(int allocType, void*, size_t size, int blockType, long, const unsigned char*, int) {
+    // 忽略 CRT 内部的分配
+    if (blockType != _CRT_BLOCK && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)) {
+        MemoryProfiler::record(size);
+    }
+    return TRUE;
+}
+#endif
+
+void MemoryProfiler::setEnabled(bool enabled) {
+#if defined(Q_OS_WIN) && defined(_DEBUG)
+    _CrtSetAllocHook(enabled ? allocHook : nullptr);
+#endif
+    sEnabled.store(enabled);
+}
+
+bool MemoryProfiler::countsMalloc() {
+#ifdef PROFILE_MALLOC_HOOK
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool MemoryProfiler::isEnabled() {
+    return sEnabled.load(std::memory_order_relaxed);
+}
+
+ProfileStage MemoryProfiler::setStage(ProfileStage stage) {
+    ProfileStage previous = tStage;
+    tStage = stage;
+    return previous;
+}
+
+void MemoryProfiler::record(size_t bytes) {
+    if (!sEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    sAllocs[tStage].fetch_add(1, std::memory_order_relaxed);
+    sBytes[tStage].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryProfiler::endCycle() {
+    if (!isEnabled()) {
+        return;
+    }
+
+    // 记录各阶段在这个周期内的分配量，保留峰值
+    for (int i = 0; i < StageCount; i++) {
+        unsigned long long allocs = sAllocs[i].load();
+        unsigned long long bytes = sBytes[i].load();
+        sPeakAllocs[i] = std::max(sPeakAllocs[i], allocs - sLastAllocs[i]);
+        sPeakBytes[i] = std::max(sPeakBytes[i], bytes - sLastBytes[i]);
+        sLastAllocs[i] = allocs;
+        sLastBytes[i] = bytes;
+    }
+
+    size_t rss = currentRss();
+    sPeakRss = std::max(sPeakRss, rss);
+    sLastRss = rss;
+
+    if (sCycles == 0) {
+        // 启动周期的一次性开销（建立城市编码表、第一次请求等）不计入其他阶段的周期峰值
+        sStartupRss = rss;
+        for (int i = 0; i < StageCount; i++) {
+            if (i != StageStartup) {
+                sPeakAllocs[i] = 0;
+                sPeakBytes[i] = 0;
+            }
+        }
+    } else {
+        sRss[sRssCount % PROFILE_MAX_SAMPLES] = rss;
+        sRssCount++;
+    }
+    sCycles++;
+}
+
+bool MemoryProfiler::setBudgets(const QString& spec) {
+    QStringList items = spec.split(",", Qt::SkipEmptyParts);
+    for (int i = 0; i < items.size(); i++) {
+        QString name = items[i].section('=', 0, 0).trimmed();
+        QStringList values = items[i].section('=', 1).split(":");
+
+        bool ok = false;
+        unsigned long long allocs = values.value(0).toULongLong(&ok);
+        if (!ok) {
+            return false;
+        }
+
+        if (name == "rss") {
+            sBudgetRss = allocs;
+            continue;
+        }
+
+        int stage = 0;
+        while (stage < StageCount && name != stageName(stage)) {
+            stage++;
+        }
+        if (stage == StageCount) {
+            return false;
+        }
+
+        sBudgetAllocs[stage] = allocs;
+        if (values.size() > 1) {
+            sBudgetBytes[stage] = values[1].toULongLong(&ok);
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool MemoryProfiler::checkBudgets() {
+    bool pass = true;
+    if (!countsMalloc()) {
+        qWarning() << "memprofile: malloc hook unavailable on this build, counts cover operator new only";
+    }
+    for (int i = 0; i < StageCount; i++) {
+        if (sBudgetAllocs[i] > 0 && sPeakAllocs[i] > sBudgetAllocs[i]) {
+            qWarning() << "memprofile: stage" << stageName(i) << "allocations per cycle"
+                       << sPeakAllocs[i] << "over budget" << sBudgetAllocs[i];
+            pass = false;
+        }
+        if (sBudgetBytes[i] > 0 && sPeakBytes[i] > sBudgetBytes[i]) {
+            qWarning() << "memprofile: stage" << stageName(i) << "bytes per cycle"
+                       << sPeakBytes[i] << "over budget" << sBudgetBytes[i];
+            pass = false;
+        }
+    }
+
+    // 以启动完成时的 RSS 为基准，之后的增长视为泄漏
+    if (sBudgetRss > 0 && sRssCount > 0 && sLastRss > sStartupRss && sLastRss - sStartupRss > sBudgetRss) {
+        qWarning() << "memprofile: rss grew" << sLastRss - sStartupRss
+                   << "bytes, over budget" << sBudgetRss;
+        pass = false;
+    }
+    return pass;
+}
+
+QString MemoryProfiler::report() {
+    QStringList lines;
+    lines << QString("memprofile: %1 cycles, counting %2")
+                 .arg(sCycles)
+                 .arg(QString(countsMalloc() ? "malloc" : "operator new only"));
+    for (int i = 0; i < StageCount; i++) {
+        lines << QString("  %1 allocs %2 bytes %3, peak per cycle allocs %4 bytes %5")
+                     .arg(QString(stageName(i)), -8)
+                     .arg(sAllocs[i].load())
+                     .arg(sBytes[i].load())
+                     .arg(sPeakAllocs[i])
+                     .arg(sPeakBytes[i]);
+    }
+
+    // 稳定状态取最近保留的采样中后一半（不含启动）的平均值
+    unsigned long long steady = 0;
+    unsigned long long kept = std::min<unsigned long long>(sRssCount, PROFILE_MAX_SAMPLES);
+    unsigned long long half = (kept + 1) / 2;
+    for (unsigned long long i = sRssCount - half; i < sRssCount; i++) {
+        steady += sRss[i % PROFILE_MAX_SAMPLES];
+    }
+    if (half > 0) {
+        steady /= half;
+    }
+    lines << QString("  rss startup %1 peak %2 steady %3 last %4")
+                 .arg(sStartupRss)
+                 .arg(sPeakRss)
+                 .arg(steady)
+                 .arg(sLastRss);
+    return lines.join("\n");
+}
+
+const char* MemoryProfiler::stageName(int stage) {
+    static const char* names[StageCount] = {
+        "startup", "lookup", "fetch", "parse", "update", "paint", "other"
+    };
+    return stage >= 0 && stage < StageCount ? names[stage] : "";
+}
+
+size_t MemoryProfiler::currentRss() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.WorkingSetSize;
+    }
+    return 0;
+#elif defined(Q_OS_LINUX)
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return 0;
+    }
+    long size = 0;
+    long resident = 0;
+    int n = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    return n == 2 ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+// glibc 上替换 malloc 系列函数，Qt 库中的分配也会经过这里
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+    MemoryProfiler::record(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    MemoryProfiler::record(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    MemoryProfiler::record(size);
+    return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+    __libc_free(p);
+}
+}
+#endif
+
+// 替换全局 operator new / delete，关闭分析模式时只多一次原子读
+// 有 malloc 一级的统计时只转发给 malloc，避免重复计数
+#ifdef PROFILE_MALLOC_HOOK
+#define RECORD_NEW(size)
+#else
+#define RECORD_NEW(size) MemoryProfiler::record(size)
+#endif
+
+void* operator new(std::size_t size) {
+    RECORD_NEW(size);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    RECORD_NEW(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    RECORD_NEW(size);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
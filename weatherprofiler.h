@@ -0,0 +1,66 @@
+﻿#ifndef WEATHERPROFILER_H
+#define WEATHERPROFILER_H
+
+#include <QString>
+#include <cstddef>
+
+// 内存分析按流水线阶段统计
+enum ProfileStage {
+    StageStartup,   // 启动：创建 QApplication 和主窗口
+    StageLookup,    // 查询城市编码和缓存
+    StageFetch,     // 发出请求、接收数据
+    StageParse,     // 解析 json
+    StageUpdateUI,  // 更新界面、预警和地区汇总
+    StagePaint,     // 绘制温度曲线
+    StageOther,     // 其他
+    StageCount
+};
+
+// 内存分析模式（--memprofile）
+// 在 malloc 一级（glibc、MSVC 调试版）或 operator new 一级（其他平台）统计各阶段的分配次数和字节数，
+// 阶段由当前线程的 ProfileScope 决定：其他线程上的分配（如 QNetworkAccessManager 内部的 HTTP 线程）
+// 没有 ProfileScope 时计入 other，fetch 阶段只包括主线程上发出请求和读取响应的部分
+// 每个刷新周期结束时调用 endCycle()，记录各阶段单个周期内的峰值和进程 RSS，
+// 最后用 checkBudgets() 检查是否超出预算
+class MemoryProfiler {
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    // 是否在 malloc 一级统计（包括 Qt 容器的缓冲区）
+    static bool countsMalloc();
+
+    // 切换当前线程的阶段，返回之前的阶段
+    static ProfileStage setStage(ProfileStage stage);
+    // 由 operator new 调用
+    static void record(size_t bytes);
+
+    // 一个刷新周期结束（第一次调用时结束的是启动阶段，之后其他阶段的峰值从零开始）
+    static void endCycle();
+
+    // 设置预算，格式 "parse=2000:262144,paint=500,rss=8388608"
+    // 阶段=单个周期最多分配次数[:最多字节数]，rss=启动后 RSS 最多增长的字节数，0 表示不限制
+    static bool setBudgets(const QString& spec);
+    // 检查是否超出预算，超出时输出警告并返回 false
+    static bool checkBudgets();
+
+    static QString report();
+    static const char* stageName(int stage);
+
+    // 当前进程的常驻内存（字节），不支持的平台返回 0
+    static size_t currentRss();
+};
+
+// 在作用域内切换阶段，离开时恢复
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileStage stage) : mPrevious(MemoryProfiler::setStage(stage)) {}
+    ~ProfileScope() { MemoryProfiler::setStage(mPrevious); }
+
+private:
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ProfileStage mPrevious;
+};
+
+#endif // WEATHERPROFILER_H
@@ -0,0 +1,155 @@
+﻿#include "weatherregion.h"
+#include "weatherprofiler.h"
+#include "weathertool.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtConcurrent>
+#include <algorithm>
+
+QJsonObject RegionSummary::toJson() const {
+    QJsonObject obj;
+    obj.insert("province", province);
+    obj.insert("cityCount", cityCount);
+    obj.insert("minHigh", minHigh);
+    obj.insert("maxHigh", maxHigh);
+    obj.insert("meanHigh", meanHigh);
+    obj.insert("minLow", minLow);
+    obj.insert("maxLow", maxLow);
+    obj.insert("meanLow", meanLow);
+    obj.insert("worstAqi", worstAqi);
+    obj.insert("worstAqiCity", worstAqiCity);
+
+    QJsonObject types;
+    for (QMap<QString, int>::const_iterator it = typeHistogram.constBegin(); it != typeHistogram.constEnd(); ++it) {
+        types.insert(it.key(), it.value());
+    }
+    obj.insert("types", types);
+    return obj;
+}
+
+void RegionAggregator::updateCity(const QString& cityCode, const Day* days, int count) {
+    QString province = WeatherTool::getProvince(cityCode);
+    if (province.isEmpty()) {
+        province = u8"未知";
+    }
+
+    CityForecast& city = mCities[cityCode];
+    if (city.province.isEmpty()) {
+        city.province = province;
+        mProvinceCities[province] << cityCode;
+    }
+
+    city.days.clear();
+    for (int i = 0; i < count; i++) {
+        city.days << days[i];
+    }
+
+    // 只有这个城市所在的省需要重算
+    mDirty.insert(province);
+}
+
+void RegionAggregator::refresh() {
+    if (mDirty.isEmpty()) {
+        return;
+    }
+
+    QList<RegionSummary> results;
+    for (QSet<QString>::const_iterator it = mDirty.constBegin(); it != mDirty.constEnd(); ++it) {
+        RegionSummary s;
+        s.province = *it;
+        results << s;
+    }
+    mDirty.clear();
+
+    // 各省之间互不依赖，在线程池中并行计算
+    QtConcurrent::blockingMap(results, [this](RegionSummary& s) {
+        // 内存分析的阶段是线程局部的，线程池中的分配也计入界面更新
+        ProfileScope scope(StageUpdateUI);
+        s = compute(s.province);
+    });
+
+    for (int i = 0; i < results.size(); i++) {
+        mSummaries.insert(results[i].province, results[i]);
+    }
+}
+
+QString RegionAggregator::provinceOf(const QString& cityCode) const {
+    return mCities.value(cityCode).province;
+}
+
+RegionSummary RegionAggregator::summary(const QString& province) {
+    refresh();
+    return mSummaries.value(province);
+}
+
+QJsonObject RegionAggregator::toJson() {
+    refresh();
+
+    QJsonArray provinces;
+    for (QMap<QString, RegionSummary>::const_iterator it = mSummaries.constBegin(); it != mSummaries.constEnd(); ++it) {
+        provinces.append(it.value().toJson());
+    }
+
+    QJsonObject root;
+    root.insert("cityCount", mCities.size());
+    root.insert("provinces", provinces);
+    return root;
+}
+
+bool RegionAggregator::exportJson(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(QJsonDocument(toJson()).toJson());
+    file.close();
+    return true;
+}
+
+// 在工作线程中调用，只读 mCities 和 mProvinceCities
+RegionSummary RegionAggregator::compute(const QString& province) const {
+    RegionSummary s;
+    s.province = province;
+
+    int dayCount = 0;
+    long long sumHigh = 0;
+    long long sumLow = 0;
+
+    QStringList codes = mProvinceCities.value(province);
+    for (int i = 0; i < codes.size(); i++) {
+        const CityForecast& city = mCities.find(codes[i]).value();
+        if (city.days.isEmpty()) {
+            continue;
+        }
+        s.cityCount++;
+
+        for (int d = 0; d < city.days.size(); d++) {
+            const Day& day = city.days[d];
+            if (dayCount == 0) {
+                s.minHigh = s.maxHigh = day.high;
+                s.minLow = s.maxLow = day.low;
+            }
+            s.minHigh = std::min(s.minHigh, day.high);
+            s.maxHigh = std::max(s.maxHigh, day.high);
+            s.minLow = std::min(s.minLow, day.low);
+            s.maxLow = std::max(s.maxLow, day.low);
+            sumHigh += day.high;
+            sumLow += day.low;
+            dayCount++;
+
+            if (day.aqi > s.worstAqi || s.worstAqiCity.isEmpty()) {
+                s.worstAqi = day.aqi;
+                s.worstAqiCity = codes[i];
+            }
+            s.typeHistogram[day.type]++;
+        }
+    }
+
+    if (dayCount > 0) {
+        s.meanHigh = double(sumHigh) / dayCount;
+        s.meanLow = double(sumLow) / dayCount;
+    }
+    return s;
+}
@@ -0,0 +1,75 @@
+﻿#ifndef WEATHERREGION_H
+#define WEATHERREGION_H
+
+#include "weatherdata.h"
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// 一个省的汇总数据
+class RegionSummary {
+public:
+    RegionSummary() {
+        cityCount = 0;
+        minHigh = maxHigh = 0;
+        minLow = maxLow = 0;
+        meanHigh = meanLow = 0;
+        worstAqi = 0;
+    }
+
+    QString province;
+    int cityCount;
+
+    int minHigh;
+    int maxHigh;
+    double meanHigh;
+
+    int minLow;
+    int maxLow;
+    double meanLow;
+
+    int worstAqi;                     // 最差的空气污染指数
+    QString worstAqiCity;
+    QMap<QString, int> typeHistogram;  // 天气类型 -> 出现的天数
+
+    QJsonObject toJson() const;
+};
+
+// 按 citycode.json 的上下级关系，把各城市的预报汇总到省
+// 城市数据更新时只把所在省标记为需要重算，读取汇总或导出时再把积累的省在多核上并行重算
+// 不依赖界面，界面和命令行导出共用
+class RegionAggregator {
+public:
+    // 更新一个城市的预报（days 天）
+    void updateCity(const QString& cityCode, const Day* days, int count);
+
+    // 重算有变化的省（读取汇总和导出时会自动调用）
+    void refresh();
+
+    // 城市所在的省（citycode.json 中找不到所属省的归为“未知”，没有更新过的城市返回空）
+    QString provinceOf(const QString& cityCode) const;
+
+    // 查询某个省的汇总
+    RegionSummary summary(const QString& province);
+
+    QJsonObject toJson();
+    bool exportJson(const QString& filePath);
+
+private:
+    struct CityForecast {
+        QString province;
+        QList<Day> days;
+    };
+
+    RegionSummary compute(const QString& province) const;
+
+    QMap<QString, CityForecast> mCities;          // 城市编码 -> 预报
+    QMap<QString, QStringList> mProvinceCities;   // 省 -> 城市编码
+    QMap<QString, RegionSummary> mSummaries;      // 省 -> 汇总
+    QSet<QString> mDirty;                         // 需要重算的省
+};
+
+#endif // WEATHERREGION_H
@@ -1,6 +1,8 @@
 ﻿#ifndef WEATHERTOOL_H
 #define WEATHERTOOL_H
+#include "weatherdata.h"
 #include <QString>
+#include <QStringList>
 #include <QMap>
 #include <QFile>
 #include <QJsonArray>
@@ -11,17 +13,37 @@
 #include <QCoreApplication>
 #include <QIODevice>
 #include <QByteArray>
+#include <QDebug>
+#include <QUrl>
+
+#define WEATHER_API_URL "http://t.weather.itboy.net/api/weather/city/"
 
 class WeatherTool {
 private:
-    static QMap<QString, QString> mCityMap;
+    // citycode.json 中的一条记录，pid 指向上级地区的 id（0 表示省级）
+    struct CityNode {
+        int pid;
+        QString name;
+    };
+
+    // C++17 inline 静态成员，可以在多个源文件中包含本头文件
+    inline static QMap<QString, QString> mCityMap;
+    inline static QMap<int, CityNode> mCityNodes;   // id -> 城市
+    inline static QMap<QString, int> mCodeIdMap;    // 城市编码 -> id
+    inline static QMap<QString, QString> mPrefixProvinceMap;  // 城市编码前 5 位（101 + 省编号）-> 省
+    inline static QString mApiUrl = WEATHER_API_URL;  // 天气接口地址，可替换为本地模拟服务器
 
     // 初始化城市名和城市编码的 map
     static void initCityMap() {
-        // 1. 读取文件
-        QString filePath = "D:/BaiduNetdiskDownload/weatherforcast/weatherforcast/citycode.json";  // 城市编码文件
-        QFile file(filePath);
-        file.open(QIODevice::ReadOnly | QIODevice::Text);
+        // 1. 读取文件：优先使用程序目录下的 citycode.json（便于更新），否则使用编译进资源的版本
+        QFile file(QCoreApplication::applicationDirPath() + "/citycode.json");
+        if (!file.exists()) {
+            file.setFileName(":/citycode.json");
+        }
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "cannot open city code file:" << file.fileName() << file.errorString();
+            return;
+        }
         QByteArray json = file.readAll();
         file.close();
 
@@ -29,26 +51,85 @@ private:
         QJsonParseError err;
         QJsonDocument doc = QJsonDocument::fromJson(json, &err);
 
-        if (err.error != QJsonParseError::NoError) {
-            return;
-        }
-
-        if (!doc.isArray()) {
+        if (err.error != QJsonParseError::NoError || !doc.isArray()) {
+            qWarning() << "invalid city code file:" << file.fileName() << err.errorString();
             return;
         }
 
         QJsonArray cities = doc.array();
         for (int i = 0; i < cities.size(); i++) {
-            QString city = cities[i].toObject().value("city_name").toString();
-            QString code = cities[i].toObject().value("city_code").toString();
+            QJsonObject obj = cities[i].toObject();
+            QString city = obj.value("city_name").toString();
+            QString code = obj.value("city_code").toString();
+            int id = obj.value("id").toInt();
+
+            // 保留上下级关系，用于按省汇总
+            CityNode node;
+            node.pid = obj.value("pid").toInt();
+            node.name = city;
+            mCityNodes.insert(id, node);
 
             if (code.size() > 0) {
                 mCityMap.insert(city, code);
+                if (!mCodeIdMap.contains(code)) {
+                    mCodeIdMap.insert(code, id);
+                }
+            }
+        }
+
+        // 3. 统计每个编码前缀下上级完整的城市属于哪个省，取最多的一个，用于上级缺失的记录
+        QMap<QString, QMap<QString, int>> prefixCounts;
+        for (QMap<QString, int>::const_iterator it = mCodeIdMap.constBegin(); it != mCodeIdMap.constEnd(); ++it) {
+            bool complete = false;
+            QString province = findRoot(it.value(), complete);
+            if (complete) {
+                prefixCounts[it.key().left(5)][province]++;
+            }
+        }
+        for (QMap<QString, QMap<QString, int>>::const_iterator it = prefixCounts.constBegin(); it != prefixCounts.constEnd(); ++it) {
+            QString best;
+            int bestCount = 0;
+            for (QMap<QString, int>::const_iterator p = it.value().constBegin(); p != it.value().constEnd(); ++p) {
+                if (p.value() > bestCount) {
+                    best = p.key();
+                    bestCount = p.value();
+                }
+            }
+            mPrefixProvinceMap.insert(it.key(), best);
+        }
+    }
+
+    // 沿 pid 向上找到最上一级，complete 表示是否一直找到了省级（pid 为 0）
+    static QString findRoot(int id, bool &complete) {
+        complete = false;
+        QMap<int, CityNode>::const_iterator it = mCityNodes.constFind(id);
+        if (it == mCityNodes.constEnd()) {
+            return "";
+        }
+
+        // 层级最多三级，限制步数以防数据中出现环
+        for (int depth = 0; depth < 8 && it.value().pid != 0; depth++) {
+            QMap<int, CityNode>::const_iterator parent = mCityNodes.constFind(it.value().pid);
+            if (parent == mCityNodes.constEnd()) {
+                return it.value().name;
             }
+            it = parent;
         }
+        complete = it.value().pid == 0;
+        return it.value().name;
     }
 
 public:
+    // 替换天气接口地址（用于对本地模拟服务器做压力测试）
+    static void setApiUrl(QString apiUrl) {
+        mApiUrl = apiUrl;
+    }
+
+    // 输入城市编码，得到天气接口的 url
+    static QUrl getWeatherUrl(QString cityCode) {
+        return QUrl(mApiUrl + cityCode);
+    }
+
     // 输入城市名，得到城市编码
     static QString getCityCode(QString cityName) {
         if (mCityMap.isEmpty()) {
@@ -65,9 +146,138 @@ public:
         }
         return "";
     }
-};
 
-// 静态成员变量，类内声明，类外初始化
-QMap<QString, QString> WeatherTool::mCityMap = {};
+    // 输入城市名前缀，得到最多 count 个候选城市编码（用于自动补全和预取）
+    static QStringList getCityCandidates(QString prefix, int count) {
+        QStringList codes;
+        if (prefix.isEmpty()) {
+            return codes;
+        }
+        if (mCityMap.isEmpty()) {
+            initCityMap();
+        }
+
+        // QMap 按 key 有序，前缀相同的城市是连续的一段
+        QMap<QString, QString>::const_iterator it = mCityMap.lowerBound(prefix);
+        for (; it != mCityMap.constEnd() && codes.size() < count; ++it) {
+            if (!it.key().startsWith(prefix)) {
+                break;
+            }
+            codes << it.value();
+        }
+        return codes;
+    }
+
+    // 输入城市编码，沿 pid 向上找到所属的省（直辖市返回自身）
+    // citycode.json 中有少量上级缺失的记录（如合作市 101161201），按城市编码前缀归省，仍找不到时返回空
+    static QString getProvince(QString cityCode) {
+        if (mCityMap.isEmpty()) {
+            initCityMap();
+        }
+
+        QMap<QString, int>::const_iterator idIt = mCodeIdMap.constFind(cityCode);
+        if (idIt == mCodeIdMap.constEnd()) {
+            return "";
+        }
+
+        bool complete = false;
+        QString province = findRoot(idIt.value(), complete);
+        if (complete) {
+            return province;
+        }
+        return mPrefixProvinceMap.value(cityCode.left(5));
+    }
+
+    // 解析天气接口返回的数据，写入今天和 6 天（昨天 + 预测 5 天）的天气
+    // 数据不完整（接口报错、预测不足 5 天、温度格式不对）时返回 false，且不修改 today 和 days
+    static bool parseWeather(const QByteArray &byteArray, Today &today, Day *days) {
+        QJsonParseError err;
+        QJsonDocument doc = QJsonDocument::fromJson(byteArray, &err);
+        if (err.error != QJsonParseError::NoError || !doc.isObject()) {
+            return false;
+        }
+
+        QJsonObject rootObj = doc.object();
+        QJsonObject objData = rootObj.value("data").toObject();
+        QJsonArray forecastArr = objData.value("forecast").toArray();
+        if (rootObj.value("status").toInt() != 200 || objData.isEmpty() || forecastArr.size() < 5) {
+            return false;
+        }
+
+        // 先解析到临时变量，全部成功后再写入
+        Day parsed[6];
+        if (!parseDay(objData.value("yesterday").toObject(), parsed[0])) {
+            return false;
+        }
+        for (int i = 0; i < 5; i++) {
+            if (!parseDay(forecastArr[i].toObject(), parsed[i + 1])) {
+                return false;
+            }
+        }
+        for (int i = 0; i < 6; i++) {
+            days[i] = parsed[i];
+        }
+
+        /****** 1. 解析日期和城市 ******/
+        today.date = rootObj.value("date").toString();
+        today.city = rootObj.value("cityInfo").toObject().value("city").toString();
+        today.cityCode = rootObj.value("cityInfo").toObject().value("citykey").toString();
+
+        /****** 2. 解析今天的数据 ******/
+        today.ganmao = objData.value("ganmao").toString();
+        today.wendu = objData.value("wendu").toString();
+        today.shidu = objData.value("shidu").toString();
+        today.pm25 = objData.value("pm25").toInt();
+        today.quality = objData.value("quality").toString();
+
+        /****** 3. forecast 中第一个数组元素，也是今天的数据 ******/
+        today.type = days[1].type;
+
+        today.fx = days[1].fx;
+        today.fl = days[1].fl;
+
+        today.high = days[1].high;
+        today.low = days[1].low;
+
+        return true;
+    }
+
+private:
+    // 解析一天的数据（yesterday 和 forecast 中的元素格式相同），格式不对返回 false
+    static bool parseDay(const QJsonObject &obj, Day &day) {
+        if (obj.isEmpty()) {
+            return false;
+        }
+
+        day.week = obj.value("week").toString();
+        day.date = obj.value("ymd").toString();
+
+        // 天气类型
+        day.type = obj.value("type").toString();
+
+        // 高温、低温，格式为 "高温 30℃"
+        QStringList high = obj.value("high").toString().split(" ");
+        QStringList low = obj.value("low").toString().split(" ");
+        if (high.size() < 2 || low.size() < 2) {
+            return false;
+        }
+
+        bool highOk = false;
+        bool lowOk = false;
+        day.high = high.at(1).left(high.at(1).length() - 1).toInt(&highOk);
+        day.low = low.at(1).left(low.at(1).length() - 1).toInt(&lowOk);
+        if (!highOk || !lowOk) {
+            return false;
+        }
+
+        // 风向、风力
+        day.fx = obj.value("fx").toString();
+        day.fl = obj.value("fl").toString();
+
+        // 污染指数 aqi
+        day.aqi = obj.value("aqi").toDouble();
+        return true;
+    }
+};
 
 #endif // WEATHERTOOL_H